@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+"""Show which sectors a sniff-mode capture is still missing.
+
+Reads the /SNIFF.COV coverage file written next to /SNIFF.IMG and prints
+the same per-track map the firmware prints over serial: '#' for a captured
+sector, '.' for one the host has not read (or written) yet.
+
+Coverage file layout:
+  byte 0     tracks
+  byte 1     sectors per track
+  bytes 2-3  sector size (little endian)
+  bytes 4-   bitmap, bit n = track * sectors + (sector - 1), LSB first
+"""
+
+import argparse
+import sys
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("coverage", help="SNIFF.COV from the SD card")
+    ap.add_argument("--missing", action="store_true", help="list missing sectors as T:S")
+    args = ap.parse_args()
+
+    with open(args.coverage, "rb") as f:
+        data = f.read()
+    if len(data) < 4:
+        sys.exit("covmap: %s is too short" % args.coverage)
+
+    tracks, spt = data[0], data[1]
+    size = data[2] | (data[3] << 8)
+    bitmap = data[4:]
+    if len(bitmap) * 8 < tracks * spt:
+        sys.exit("covmap: bitmap shorter than %dT/%dS geometry" % (tracks, spt))
+
+    def captured(t, s):
+        n = t * spt + (s - 1)
+        return bool(bitmap[n >> 3] & (1 << (n & 7)))
+
+    missing = [(t, s) for t in range(tracks) for s in range(1, spt + 1) if not captured(t, s)]
+    total = tracks * spt
+    print("Coverage: %d/%d sectors (%dT/%dS/%dB)" % (total - len(missing), total, tracks, spt, size))
+
+    if args.missing:
+        for t, s in missing:
+            print("%d:%d" % (t, s))
+        return
+
+    for t in range(tracks):
+        print("T%02d %s" % (t, "".join("#" if captured(t, s) else "." for s in range(1, spt + 1))))
+
+
+if __name__ == "__main__":
+    main()
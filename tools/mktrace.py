@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Generate a WD1770 bus trace of a host reading a disk image.
+
+The trace is what sniff mode would see on the bus if a host read the
+image through a real WD1770. Copy it to the SD card as SNIFF.TRC and boot
+with SNIFF_MODE=1 and TEST_MODE=1 to replay it; the resulting SNIFF.IMG
+should match the source image for every sector marked captured.
+
+Trace format, one bus cycle per line:
+  R a dd    CPU read of register a, data dd (hex)
+  W a dd    CPU write of register a, data dd (hex)
+  I         host idle gap (sniffer may flush to SD)
+  # ...     comment
+"""
+
+import argparse
+import random
+import sys
+
+ST_BUSY = 0x01
+ST_DRQ = 0x02
+ST_LOST_DATA = 0x04
+ST_CRC_ERROR = 0x08
+ST_RNF = 0x10
+
+
+def parse_sectors(specs):
+    out = set()
+    for spec in specs or []:
+        t, s = spec.split(":")
+        out.add((int(t), int(s)))
+    return out
+
+
+class Trace:
+    def __init__(self, out):
+        self.out = out
+
+    def r(self, addr, data):
+        self.out.write("R %d %02X\n" % (addr, data))
+
+    def w(self, addr, data):
+        self.out.write("W %d %02X\n" % (addr, data))
+
+    def idle(self):
+        self.out.write("I\n")
+
+    def comment(self, text):
+        self.out.write("# %s\n" % text)
+
+
+def seek(tr, track):
+    tr.w(3, track)
+    tr.w(0, 0x10)
+    tr.r(0, ST_BUSY)
+    tr.r(0, 0x04 if track == 0 else 0x00)
+
+
+def read_sector(tr, data, track, sector, crc_error=False):
+    tr.w(2, sector)
+    tr.w(0, 0x80)
+    tr.r(0, ST_BUSY)
+    payload = bytearray(data)
+    if crc_error:
+        payload[len(payload) // 2] ^= 0xFF
+    for i, b in enumerate(payload):
+        tr.r(3, b)
+        if i % 64 == 63:
+            tr.r(0, ST_BUSY | ST_DRQ)
+    tr.r(0, ST_CRC_ERROR if crc_error else 0x00)
+
+
+def read_track_multi(tr, sectors, track):
+    tr.w(2, 1)
+    tr.w(0, 0x90)
+    tr.r(0, ST_BUSY)
+    for data in sectors:
+        for b in data:
+            tr.r(3, b)
+    # Multi-sector read ends with RNF once it runs past the last sector
+    tr.r(0, ST_RNF)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image", help="raw sector image (track-major)")
+    ap.add_argument("-o", "--output", default="-", help="trace file (default stdout)")
+    ap.add_argument("--tracks", type=int, default=40)
+    ap.add_argument("--sectors", type=int, default=16)
+    ap.add_argument("--size", type=int, default=256)
+    ap.add_argument("--multi", action="store_true", help="read each track with one multi-sector command")
+    ap.add_argument("--shuffle", type=int, metavar="SEED", help="read tracks in random order")
+    ap.add_argument("--skip", action="append", metavar="T:S", help="never read this sector")
+    ap.add_argument("--crc", action="append", metavar="T:S", help="first read fails with CRC error, then retried")
+    args = ap.parse_args()
+
+    with open(args.image, "rb") as f:
+        image = f.read()
+    need = args.tracks * args.sectors * args.size
+    if len(image) < need:
+        sys.exit("mktrace: image is %d bytes, geometry needs %d" % (len(image), need))
+
+    skip = parse_sectors(args.skip)
+    crc = parse_sectors(args.crc)
+
+    def sector_data(t, s):
+        off = (t * args.sectors + (s - 1)) * args.size
+        return image[off:off + args.size]
+
+    out = sys.stdout if args.output == "-" else open(args.output, "w")
+    tr = Trace(out)
+    tr.comment("mktrace %s %dT/%dS/%dB" % (args.image, args.tracks, args.sectors, args.size))
+
+    tr.w(0, 0x00)
+    tr.r(0, ST_BUSY)
+    tr.r(0, 0x04)
+    tr.idle()
+
+    order = list(range(args.tracks))
+    if args.shuffle is not None:
+        random.Random(args.shuffle).shuffle(order)
+
+    for t in order:
+        seek(tr, t)
+        if args.multi and not any(k[0] == t for k in skip | crc):
+            read_track_multi(tr, [sector_data(t, s) for s in range(1, args.sectors + 1)], t)
+            tr.idle()
+            continue
+        for s in range(1, args.sectors + 1):
+            if (t, s) in skip:
+                continue
+            if (t, s) in crc:
+                read_sector(tr, sector_data(t, s), t, s, crc_error=True)
+                tr.idle()
+            read_sector(tr, sector_data(t, s), t, s)
+            tr.idle()
+
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
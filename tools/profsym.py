@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""Symbolise a WD1770-SD profiler dump against the sketch ELF.
+
+Input is the text between "PROF BEGIN" and "PROF END" printed by the
+firmware in response to the 'p' serial command, either from a capture file
+or read live from the USB serial port.
+
+Reports:
+  functions  per-function profile with the library each function came from
+  flat       per-bucket profile with function+offset and source line
+  folded     module;function count lines for flamegraph.pl / speedscope
+"""
+
+import argparse
+import bisect
+import os
+import subprocess
+import sys
+import termios
+import time
+
+
+def read_dump_lines(args):
+    if args.port:
+        return read_port(args.port, args.timeout)
+    src = sys.stdin if args.dump == "-" else open(args.dump, "r", errors="replace")
+    with src:
+        return src.read().splitlines()
+
+
+def read_port(port, timeout):
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    try:
+        attrs = termios.tcgetattr(fd)
+        attrs[0] = 0
+        attrs[1] = 0
+        attrs[3] = 0
+        attrs[4] = attrs[5] = termios.B115200
+        attrs[6][termios.VMIN] = 0
+        attrs[6][termios.VTIME] = 1
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        termios.tcflush(fd, termios.TCIFLUSH)
+        os.write(fd, b"p")
+
+        buf = b""
+        deadline = time.time() + timeout
+        while b"PROF END" not in buf:
+            if time.time() > deadline:
+                sys.exit("profsym: timed out waiting for PROF END on " + port)
+            buf += os.read(fd, 4096)
+        return buf.decode("ascii", "replace").splitlines()
+    finally:
+        os.close(fd)
+
+
+def parse_dump(lines):
+    meta = {}
+    buckets = []
+    inside = False
+    for line in lines:
+        line = line.strip()
+        if line == "PROF BEGIN":
+            inside = True
+            meta = {}
+            buckets = []
+            continue
+        if line == "PROF END":
+            inside = False
+            continue
+        if not inside or not line:
+            continue
+        parts = line.split()
+        if parts[0] == "b" and len(parts) == 3:
+            buckets.append((int(parts[1], 16), int(parts[2])))
+        elif parts[0] == "base":
+            meta["base"] = int(parts[1], 16)
+        elif len(parts) == 2:
+            meta[parts[0]] = int(parts[1])
+
+    for key in ("base", "shift", "samples"):
+        if key not in meta:
+            sys.exit("profsym: no complete PROF BEGIN/END block found")
+    return meta, buckets
+
+
+def load_symbols(elf, prefix):
+    out = subprocess.run(
+        [prefix + "nm", "-n", "-S", "-C", "--defined-only", elf],
+        check=True, stdout=subprocess.PIPE, universal_newlines=True).stdout
+
+    syms = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4 or parts[2] not in "tTwW":
+            continue
+        addr = int(parts[0], 16) & ~1
+        size = int(parts[1], 16)
+        if size:
+            syms.append((addr, size, parts[3]))
+    syms.sort()
+    return syms
+
+
+def addr2line(elf, prefix, addrs):
+    if not addrs:
+        return {}
+    proc = subprocess.run(
+        [prefix + "addr2line", "-e", elf, "-f", "-C"],
+        input="\n".join("0x%x" % a for a in addrs) + "\n",
+        check=True, stdout=subprocess.PIPE, universal_newlines=True)
+    lines = proc.stdout.splitlines()
+    return {a: lines[2 * i + 1] for i, a in enumerate(addrs)}
+
+
+def module_of(path):
+    p = path.replace("\\", "/")
+    if p.startswith("??"):
+        return "unknown"
+    if "/SdFat/" in p:
+        return "SdFat"
+    if "/U8g2/" in p:
+        return "U8g2"
+    if "/cores/arduino/" in p:
+        return "core"
+    if "/system/" in p or "/libraries/SrcWrapper/" in p or "/Drivers/" in p:
+        return "hal"
+    if "/libraries/" in p:
+        return p.split("/libraries/", 1)[1].split("/", 1)[0]
+    if "newlib" in p or "/libc/" in p or "/libgcc/" in p:
+        return "libc"
+    return "sketch"
+
+
+def attribute(meta, buckets, syms):
+    """Split each bucket's count across the functions it overlaps."""
+    size = 1 << meta["shift"]
+    starts = [s[0] for s in syms]
+    per_func = {}
+    per_bucket = []
+
+    for index, count in buckets:
+        lo = meta["base"] + (index << meta["shift"])
+        hi = lo + size
+        hits = []
+        covered = 0
+        i = max(bisect.bisect_right(starts, lo) - 1, 0)
+        while i < len(syms) and syms[i][0] < hi:
+            s_addr, s_size, name = syms[i]
+            overlap = min(hi, s_addr + s_size) - max(lo, s_addr)
+            if overlap > 0:
+                hits.append((name, s_addr, overlap))
+                covered += overlap
+            i += 1
+        if covered < size:
+            hits.append(("[unknown]", None, size - covered))
+
+        for name, s_addr, overlap in hits:
+            share = count * overlap / float(size)
+            entry = per_func.setdefault(name, [0.0, s_addr])
+            entry[0] += share
+        per_bucket.append((lo, count, hits))
+
+    return per_func, per_bucket
+
+
+def report_functions(meta, per_func, modules, limit, out):
+    total = float(meta["samples"]) or 1.0
+    out.write("# %d samples at %d Hz, %d outside flash window, %d in interrupt handlers\n"
+              % (meta["samples"], meta.get("hz", 0), meta.get("outside", 0), meta.get("isr", 0)))
+    out.write("%7s %9s  %-8s %s\n" % ("%", "samples", "module", "function"))
+    rows = sorted(per_func.items(), key=lambda kv: -kv[1][0])
+    for name, (count, addr) in rows[:limit]:
+        out.write("%6.2f%% %9.1f  %-8s %s\n"
+                  % (100.0 * count / total, count, modules.get(addr, "unknown"), name))
+
+
+def report_flat(meta, per_bucket, sources, limit, out):
+    total = float(meta["samples"]) or 1.0
+    out.write("%7s %9s  %-10s %-40s %s\n"
+              % ("%", "samples", "address", "function+offset", "source"))
+    rows = sorted(per_bucket, key=lambda b: -b[1])
+    for lo, count, hits in rows[:limit]:
+        name, s_addr, _ = max(hits, key=lambda h: h[2])
+        where = name if s_addr is None else "%s+0x%x" % (name, max(lo - s_addr, 0))
+        out.write("%6.2f%% %9d  0x%08x %-40s %s\n"
+                  % (100.0 * count / total, count, lo, where, sources.get(lo, "??")))
+
+
+def report_folded(meta, per_func, modules, out):
+    for name, (count, addr) in sorted(per_func.items()):
+        n = int(round(count))
+        if n:
+            out.write("%s;%s %d\n" % (modules.get(addr, "unknown"), name.replace(";", ":"), n))
+    if meta.get("outside"):
+        out.write("unknown;[outside flash window] %d\n" % meta["outside"])
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("elf", help="sketch ELF from the same build that produced the dump")
+    ap.add_argument("dump", nargs="?", default="-", help="captured serial log (default stdin)")
+    ap.add_argument("--port", help="read the dump live from this serial device")
+    ap.add_argument("--timeout", type=float, default=10.0)
+    ap.add_argument("--mode", choices=("functions", "flat", "folded"), default="functions")
+    ap.add_argument("--limit", type=int, default=40)
+    ap.add_argument("--prefix", default="arm-none-eabi-", help="toolchain prefix")
+    args = ap.parse_args()
+
+    meta, buckets = parse_dump(read_dump_lines(args))
+    syms = load_symbols(args.elf, args.prefix)
+    per_func, per_bucket = attribute(meta, buckets, syms)
+
+    func_addrs = sorted(a for _, a in per_func.values() if a is not None)
+    modules = {a: module_of(src) for a, src in addr2line(args.elf, args.prefix, func_addrs).items()}
+
+    out = sys.stdout
+    if args.mode == "functions":
+        report_functions(meta, per_func, modules, args.limit, out)
+    elif args.mode == "flat":
+        sources = addr2line(args.elf, args.prefix, [b[0] for b in per_bucket])
+        report_flat(meta, per_bucket, sources, args.limit, out)
+    else:
+        report_folded(meta, per_func, modules, out)
+
+
+if __name__ == "__main__":
+    main()
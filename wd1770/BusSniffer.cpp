@@ -0,0 +1,338 @@
+#include "BusSniffer.h"
+#include "FdcDevice.h"
+
+BusSniffer::BusSniffer() {
+  sd = nullptr;
+  ready = false;
+  trackReg = 0;
+  sectorReg = 1;
+  dataReg = 0;
+  stepDir = 1;
+  phase = SNIFF_IDLE;
+  multi = false;
+  curTrack = 0;
+  curSector = 1;
+  byteIndex = 0;
+  sectorsDone = 0;
+  slot = nullptr;
+  pending = false;
+  lastCycle = 0;
+  queueHead = 0;
+  queueTail = 0;
+  queueGap = false;
+  droppedCycles = 0;
+}
+
+bool BusSniffer::begin(SdFat32* sdCard, uint8_t tracks, uint8_t sectorsPerTrack, uint16_t sectorSize) {
+  sd = sdCard;
+  ready = writer.begin(sdCard, SNIFF_IMAGE_FILE, SNIFF_COVERAGE_FILE,
+                       tracks, sectorsPerTrack, sectorSize);
+  if (!ready) {
+    DBGLN("Sniff: Could not prepare " SNIFF_IMAGE_FILE);
+    return false;
+  }
+
+  DBG("Sniff: Imaging to " SNIFF_IMAGE_FILE " (");
+  DBG(tracks);
+  DBG("T/");
+  DBG(sectorsPerTrack);
+  DBG("S/");
+  DBG(sectorSize);
+  DBG("B), ");
+  DBG(getCapturedCount());
+  DBG("/");
+  DBG(getTotalSectors());
+  DBGLN(" captured");
+  return true;
+}
+
+void BusSniffer::onBusCycle(uint8_t addr, bool read, uint8_t data) {
+  if (!ready) return;
+  lastCycle = micros();
+
+  if (read) {
+    switch (addr) {
+      case 0:
+        onStatus(data);
+        break;
+      case 1:
+        trackReg = data;
+        break;
+      case 2:
+        sectorReg = data;
+        break;
+      case 3:
+        // Data without a seen command: the command (and possibly a sector
+        // register write) was missed, so the sector is unknown - skip it
+        if (phase == SNIFF_IDLE) phase = SNIFF_OTHER;
+        if (phase == SNIFF_READ_DATA) captureByte(data);
+        break;
+    }
+  } else {
+    switch (addr) {
+      case 0:
+        onCommand(data);
+        break;
+      case 1:
+        trackReg = data;
+        break;
+      case 2:
+        sectorReg = data;
+        break;
+      case 3:
+        dataReg = data;
+        if (phase == SNIFF_WRITE_DATA) captureByte(data);
+        break;
+    }
+  }
+}
+
+void BusSniffer::captureCycle(uint8_t addr, bool read, uint8_t data) {
+  uint16_t head = queueHead;
+  uint16_t next = (head + 1) & (SNIFF_QUEUE_SIZE - 1);
+  if (next == queueTail) {
+    queueGap = true;
+    droppedCycles++;
+    return;
+  }
+  
+  uint16_t entry = data | ((uint16_t)(addr & 0x03) << 8);
+  if (read) entry |= SNIFF_CYCLE_READ;
+  if (queueGap) {
+    entry |= SNIFF_CYCLE_GAP;
+    queueGap = false;
+  }
+  cycleQueue[head] = entry;
+  queueHead = next;
+}
+
+void BusSniffer::processCycles() {
+  uint16_t tail = queueTail;
+  while (tail != queueHead) {
+    uint16_t entry = cycleQueue[tail];
+    tail = (tail + 1) & (SNIFF_QUEUE_SIZE - 1);
+    queueTail = tail;
+    
+    if (entry & SNIFF_CYCLE_GAP) dropTransfer();
+    onBusCycle((entry >> 8) & 0x03, entry & SNIFF_CYCLE_READ, entry & 0xFF);
+  }
+}
+
+void BusSniffer::onCommand(uint8_t cmd) {
+  // A new command means the previous transfer was not aborted with an error
+  commitPending();
+  endCommand();
+
+  switch (cmd & 0xF0) {
+    case CMD_RESTORE:
+      trackReg = 0;
+      return;
+    case CMD_SEEK:
+      trackReg = dataReg;
+      return;
+    case CMD_READ_SECTOR:
+    case CMD_READ_SECTORS:
+      startData(SNIFF_READ_DATA, cmd & 0x10);
+      return;
+    case CMD_WRITE_SECTOR:
+    case CMD_WRITE_SECTORS:
+      startData(SNIFF_WRITE_DATA, cmd & 0x10);
+      return;
+    case CMD_FORCE_INT:
+      return;
+  }
+
+  switch (cmd & 0xE0) {
+    case CMD_STEP_IN:
+      stepDir = 1;
+      break;
+    case CMD_STEP_OUT:
+      stepDir = -1;
+      break;
+    case CMD_STEP:
+      break;
+    default:
+      // Read Address, Read Track, Write Track: data not captured
+      phase = SNIFF_OTHER;
+      return;
+  }
+  if (cmd & 0x10) trackReg += stepDir;
+}
+
+void BusSniffer::onStatus(uint8_t status) {
+  if (status & ST_BUSY) return;
+
+  if (phase == SNIFF_READ_DATA || phase == SNIFF_WRITE_DATA) {
+    // CRC/lost data apply to the last sector transferred; RNF only ends
+    // a multi-sector command after its last good sector
+    if (!(status & (ST_CRC_ERROR | ST_LOST_DATA | ST_WRITE_PROTECT))) {
+      commitPending();
+    }
+  }
+  endCommand();
+}
+
+void BusSniffer::startData(SniffPhase p, bool multiSector) {
+  phase = p;
+  multi = multiSector;
+  curTrack = trackReg;
+  curSector = sectorReg;
+  byteIndex = 0;
+  sectorsDone = 0;
+  slot = nullptr;
+  pending = false;
+}
+
+void BusSniffer::captureByte(uint8_t b) {
+  uint16_t sectorSize = writer.getSectorSize();
+  if (byteIndex >= sectorSize) return;
+
+  if (byteIndex == 0) {
+    if (sectorsDone > 0) {
+      commitPending();
+      curSector++;
+    }
+    slot = writer.reserve();
+  }
+
+  if (slot) slot[byteIndex] = b;
+  if (++byteIndex == sectorSize) {
+    pending = (slot != nullptr);
+    sectorsDone++;
+    if (multi) byteIndex = 0;
+  }
+}
+
+void BusSniffer::commitPending() {
+  if (!pending) return;
+  writer.commit(curTrack, curSector);
+  pending = false;
+}
+
+void BusSniffer::endCommand() {
+  phase = SNIFF_IDLE;
+  byteIndex = 0;
+  sectorsDone = 0;
+  slot = nullptr;
+  pending = false;
+}
+
+void BusSniffer::dropTransfer() {
+  // Cycles were lost: the sector being transferred cannot be trusted and
+  // the rest of its data is ignored until the next status read or command
+  endCommand();
+  phase = SNIFF_OTHER;
+}
+
+void BusSniffer::service() {
+  if (!ready) return;
+
+  uint32_t quiet = micros() - lastCycle;
+  if (phase != SNIFF_IDLE && quiet >= SNIFF_STALL_US) {
+    commitPending();
+    endCommand();
+  }
+  
+  // Full buffers go out at once, capture continues into the cycle queue;
+  // a partly filled buffer waits for the host to go quiet
+  if (writer.hasReady()) {
+    flush();
+  } else if (phase == SNIFF_IDLE && quiet >= SNIFF_IDLE_US) {
+    writer.seal();
+    flush();
+  }
+  if (quiet >= SNIFF_SYNC_US && writer.syncCoverage()) {
+    // Host has paused: show which sectors it still has to read
+#if DEBUG_SERIAL
+    printCoverage(Serial);
+#endif
+  }
+}
+
+void BusSniffer::flush() {
+  uint16_t written = writer.flush();
+  if (written == 0) return;
+
+  DBG("Sniff: +");
+  DBG(written);
+  DBG(" sectors, ");
+  DBG(getCapturedCount());
+  DBG("/");
+  DBGLN(getTotalSectors());
+}
+
+bool BusSniffer::replay(const char* path) {
+  if (!ready) return false;
+
+  File32 trace = sd->open(path, O_READ);
+  if (!trace) {
+    DBG("Sniff: No trace ");
+    DBGLN(path);
+    return false;
+  }
+
+  DBG("Sniff: Replaying ");
+  DBGLN(path);
+
+  // Line format: "R a dd" / "W a dd" (hex), "I" = host idle gap, "#" comment
+  char line[32];
+  uint32_t cycles = 0;
+  while (trace.available()) {
+    int n = 0;
+    while (trace.available()) {
+      char c = trace.read();
+      if (c == '\n') break;
+      if (c != '\r' && n < (int)sizeof(line) - 1) line[n++] = c;
+    }
+    line[n] = '\0';
+
+    if (line[0] == 'R' || line[0] == 'W') {
+      char* p = line + 1;
+      uint8_t addr = strtoul(p, &p, 16);
+      uint8_t data = strtoul(p, &p, 16);
+      onBusCycle(addr & 0x03, line[0] == 'R', data);
+      cycles++;
+    } else if (line[0] == 'I' && phase == SNIFF_IDLE) {
+      writer.seal();
+      flush();
+    }
+  }
+  trace.close();
+
+  commitPending();
+  endCommand();
+  writer.seal();
+  flush();
+  writer.syncCoverage();
+
+  DBG("Sniff: Replayed ");
+  DBG(cycles);
+  DBGLN(" bus cycles");
+#if DEBUG_SERIAL
+  printCoverage(Serial);
+#endif
+  return true;
+}
+
+void BusSniffer::printCoverage(Print& out) {
+  out.print("Coverage: ");
+  out.print(getCapturedCount());
+  out.print("/");
+  out.print(getTotalSectors());
+  out.print(" sectors, ");
+  out.print(getOverruns());
+  out.print(" overruns, ");
+  out.print(getDroppedCycles());
+  out.println(" dropped cycles");
+
+  char row[SNIFF_MAX_SLOTS + 8];
+  uint8_t spt = writer.getSectorsPerTrack();
+  for (uint8_t t = 0; t < writer.getTracks(); t++) {
+    snprintf(row, sizeof(row), "T%02d ", t);
+    for (uint8_t s = 1; s <= spt; s++) {
+      row[3 + s] = writer.isWritten(t, s) ? '#' : '.';
+    }
+    row[4 + spt] = '\0';
+    out.println(row);
+  }
+}
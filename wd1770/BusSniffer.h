@@ -0,0 +1,110 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include "Hardware.h"
+#include "SectorWriter.h"
+
+// Listen-only decoder for a host talking to a real WD1770.
+// Mirrors the track/sector/data registers from observed bus cycles and
+// captures the data bytes of Read Sector (from the controller) and
+// Write Sector (from the host) into an image on SD.
+//
+// Cycles are sampled by the CS interrupt into a queue and decoded from
+// loop(), so SD writes do not stall capture as long as the queue holds.
+
+#define SNIFF_IMAGE_FILE      "/SNIFF.IMG"
+#define SNIFF_COVERAGE_FILE   "/SNIFF.COV"
+#define SNIFF_TRACE_FILE      "/SNIFF.TRC"
+
+// Geometry of the disk being imaged (Timex FDD 3000)
+#define SNIFF_TRACKS          40
+#define SNIFF_SECTORS         16
+#define SNIFF_SECTOR_SIZE     256
+
+// Bus cycles queued by the CS interrupt (power of two, ~130ms of DD reads)
+#define SNIFF_QUEUE_SIZE      4096
+#define SNIFF_CYCLE_READ      0x0400
+#define SNIFF_CYCLE_GAP       0x0800    // cycles were dropped before this one
+
+// Bus quiet time before a partly filled buffer is written to SD
+#define SNIFF_IDLE_US         50000
+// Bus quiet time before the coverage map is saved
+#define SNIFF_SYNC_US         2000000
+// Bus quiet time after which an unfinished command is closed; longer than
+// the 5 revolutions (1s at 300rpm) a WD1770 searches before reporting RNF,
+// so a host waiting on INTRQ/DRQ for a slow sector is not cut off
+#define SNIFF_STALL_US        1200000
+
+typedef enum {
+  SNIFF_IDLE,
+  SNIFF_READ_DATA,
+  SNIFF_WRITE_DATA,
+  SNIFF_OTHER
+} SniffPhase;
+
+class BusSniffer {
+public:
+  BusSniffer();
+
+  // Initialization
+  bool begin(SdFat32* sdCard, uint8_t tracks, uint8_t sectorsPerTrack, uint16_t sectorSize);
+
+  // One CPU access to the controller: register, direction, byte on the bus
+  void onBusCycle(uint8_t addr, bool read, uint8_t data);
+
+  // Queue a bus cycle (CS interrupt) and decode queued cycles (loop)
+  void captureCycle(uint8_t addr, bool read, uint8_t data);
+  void processCycles();
+
+  // Write buffered sectors and coverage to SD
+  void service();
+
+  // Feed a recorded trace through the decoder (see tools/mktrace.py)
+  bool replay(const char* path);
+
+  // Coverage
+  uint16_t getCapturedCount() const { return writer.getWrittenCount(); }
+  uint16_t getTotalSectors() const { return writer.getTotalSectors(); }
+  uint16_t getOverruns() const { return writer.getOverruns(); }
+  uint32_t getDroppedCycles() const { return droppedCycles; }
+  void printCoverage(Print& out);
+
+private:
+  SdFat32* sd;
+  SectorWriter writer;
+  bool ready;
+
+  // Mirrored controller registers
+  uint8_t trackReg;
+  uint8_t sectorReg;
+  uint8_t dataReg;
+  int8_t stepDir;
+
+  // Current data transfer
+  SniffPhase phase;
+  bool multi;
+  uint8_t curTrack;
+  uint8_t curSector;
+  uint16_t byteIndex;
+  uint8_t sectorsDone;
+  uint8_t* slot;
+  bool pending;
+  uint32_t lastCycle;
+
+  // Cycle queue (single producer: CS interrupt, single consumer: loop)
+  volatile uint16_t cycleQueue[SNIFF_QUEUE_SIZE];
+  volatile uint16_t queueHead;
+  volatile uint16_t queueTail;
+  volatile bool queueGap;
+  volatile uint32_t droppedCycles;
+
+  void onCommand(uint8_t cmd);
+  void onStatus(uint8_t status);
+  void startData(SniffPhase p, bool multiSector);
+  void captureByte(uint8_t b);
+  void commitPending();
+  void endCommand();
+  void dropTransfer();
+  void flush();
+};
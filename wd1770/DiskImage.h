@@ -7,6 +7,15 @@
 #define SIZE_CPC_40T            184320   // 180KB: 40T/9S/512B
 #define SIZE_35_DD              737280   // 720KB: 80T/9S/512B
 #define SIZE_525_DD             368640   // 360KB: 40T/9S/512B
+#define SIZE_TRD_80DS           655360   // 640KB: TR-DOS 80 cyl, 2 sides, 16S/256B
+
+// TR-DOS layout
+#define TRD_SECTOR_SIZE         256
+#define TRD_SECTORS_PER_TRACK   16
+#define TRD_CATALOG_SECTORS     9        // 8 catalog sectors + system sector
+#define TRD_CATALOG_SIZE        (TRD_CATALOG_SECTORS * TRD_SECTOR_SIZE)
+#define TRD_MAX_FILES           128
+#define TRD_TOTAL_SECTORS       2560     // 80 cyl x 2 sides x 16
 
 // Disk image metadata structure
 typedef struct {
@@ -20,4 +29,8 @@ typedef struct {
   bool isExtendedDSK;       // True if Extended DSK format with headers
   uint16_t headerOffset;    // Offset to skip headers (256 bytes typically)
   uint16_t trackHeaderSize; // Track Information Block size (256 bytes)
+  bool isTRD;               // TR-DOS image (native .TRD)
+  bool isSCL;               // SCL archive mounted as a virtual TRD
+  uint32_t sclDataOffset;   // Offset of first file data sector in the SCL
+  uint16_t sclDataSectors;  // Number of file data sectors in the SCL
 } DiskImage;
@@ -18,7 +18,15 @@ DiskManager::DiskManager() {
     disks[i].isExtendedDSK = false;
     disks[i].headerOffset = 0;
     disks[i].trackHeaderSize = 0;
+    disks[i].isTRD = false;
+    disks[i].isSCL = false;
+    disks[i].sclDataOffset = 0;
+    disks[i].sclDataSectors = 0;
   }
+  memset(trdCatalog, 0, sizeof(trdCatalog));
+  cacheDrive = -1;
+  cacheTrack = 0;
+  cacheDirty = 0;
 }
 
 bool DiskManager::begin(SdFat32* sdCard) {
@@ -52,7 +60,8 @@ void DiskManager::scanImages() {
       for (int j = 0; upper[j]; j++) upper[j] = toupper(upper[j]);
 
       if (strstr(upper, ".DSK") || strstr(upper, ".IMG") ||
-          strstr(upper, ".ST")  || strstr(upper, ".HFE")) {
+          strstr(upper, ".ST")  || strstr(upper, ".HFE") ||
+          strstr(upper, ".TRD") || strstr(upper, ".SCL")) {
         if (totalImages < MAX_DISK_IMAGES) {
           strncpy(diskImages[totalImages], filename, 63);
           diskImages[totalImages][63] = '\0';
@@ -82,6 +91,8 @@ bool DiskManager::loadImage(uint8_t drive, int imageIndex) {
   if (drive >= MAX_DRIVES || imageIndex >= totalImages || imageIndex < 0) {
     return false;
   }
+  
+  if (cacheDrive == drive) releaseCache();
 
   char filename[70];
   snprintf(filename, sizeof(filename), "/%s", diskImages[imageIndex]);
@@ -100,27 +111,45 @@ bool DiskManager::loadImage(uint8_t drive, int imageIndex) {
   disk->size = imageFile.size();
   imageFile.close();
 
-  // Detect format by size
-  if (!detectFormat(disk, disk->size)) {
-    DBGLN("  Warning: Unknown disk format");
-  }
-
   disk->writeProtected = false;
   disk->isExtendedDSK = false;
   disk->headerOffset = 0;
   disk->trackHeaderSize = 0;
-  loadedImageIndex[drive] = imageIndex;
+  disk->isTRD = false;
+  disk->isSCL = false;
+  disk->sclDataOffset = 0;
+  disk->sclDataSectors = 0;
   
-  // Check for Extended DSK header
   char extCheck[70];
   strncpy(extCheck, filename, 69);
+  extCheck[69] = '\0';
   for (int i = 0; extCheck[i]; i++) extCheck[i] = toupper(extCheck[i]);
   
-  if (strstr(extCheck, ".DSK") || strstr(extCheck, ".HFE")) {
-    if (parseExtendedDSK(drive, filename)) {
-      DBGLN("  Extended DSK header parsed successfully");
+  if (strstr(extCheck, ".SCL")) {
+    if (!parseSCL(drive, filename)) {
+      DBGLN("  Error: Invalid SCL archive");
+      disk->filename[0] = '\0';
+      disk->size = 0;
+      loadedImageIndex[drive] = -1;
+      eventBus.publish(EVT_MOUNT_COMPLETE, drive, 0xFFFF);
+      return false;
+    }
+  } else if (strstr(extCheck, ".TRD")) {
+    parseTRD(drive, filename);
+  } else {
+    // Detect format by size
+    if (!detectFormat(disk, disk->size)) {
+      DBGLN("  Warning: Unknown disk format");
+    }
+    
+    // Check for Extended DSK header
+    if (strstr(extCheck, ".DSK") || strstr(extCheck, ".HFE")) {
+      if (parseExtendedDSK(drive, filename)) {
+        DBGLN("  Extended DSK header parsed successfully");
+      }
     }
   }
+  loadedImageIndex[drive] = imageIndex;
 
   DBG("Drive ");
   DBG(drive);
@@ -136,19 +165,26 @@ bool DiskManager::loadImage(uint8_t drive, int imageIndex) {
   DBG(disk->sectorSize);
   DBGLN("B)");
 
+  eventBus.publish(EVT_MOUNT_COMPLETE, drive, imageIndex);
   return true;
 }
 
 void DiskManager::ejectDrive(uint8_t drive) {
   if (drive >= MAX_DRIVES) return;
   
+  if (cacheDrive == drive) releaseCache();
+  
   disks[drive].filename[0] = '\0';
   disks[drive].size = 0;
+  disks[drive].isTRD = false;
+  disks[drive].isSCL = false;
   loadedImageIndex[drive] = -1;
   
   DBG("Drive ");
   DBG(drive);
   DBGLN(" ejected");
+  
+  eventBus.publish(EVT_MOUNT_COMPLETE, drive, 0xFFFF);
 }
 
 bool DiskManager::detectFormat(DiskImage* disk, uint32_t fileSize) {
@@ -324,6 +360,410 @@ bool DiskManager::parseExtendedDSK(uint8_t drive, const char* filename) {
   return true;
 }
 
+void DiskManager::setTrdGeometry(DiskImage* disk, uint8_t diskType) {
+  // TR-DOS tracks are stored cylinder-major, both sides interleaved,
+  // so a double-sided disk is exposed as 2x cylinders linear tracks
+  switch (diskType) {
+    case 0x16: disk->tracks = 160; break;  // 80 cyl, DS
+    case 0x17: disk->tracks = 80;  break;  // 40 cyl, DS
+    case 0x18: disk->tracks = 80;  break;  // 80 cyl, SS
+    case 0x19: disk->tracks = 40;  break;  // 40 cyl, SS
+    default:
+      disk->tracks = (disk->size + (TRD_SECTORS_PER_TRACK * TRD_SECTOR_SIZE) - 1) /
+                     (TRD_SECTORS_PER_TRACK * TRD_SECTOR_SIZE);
+      if (disk->tracks == 0) disk->tracks = 160;
+      break;
+  }
+  disk->sectorsPerTrack = TRD_SECTORS_PER_TRACK;
+  disk->sectorSize = TRD_SECTOR_SIZE;
+  disk->doubleDensity = true;
+}
+
+bool DiskManager::parseTRD(uint8_t drive, const char* filename) {
+  DiskImage* disk = &disks[drive];
+  disk->isTRD = true;
+  
+  uint8_t sys[TRD_SECTOR_SIZE];
+  uint8_t diskType = 0;
+  
+  File32 imageFile = sd->open(filename, O_READ);
+  if (imageFile) {
+    if (imageFile.seek(8 * TRD_SECTOR_SIZE) &&
+        imageFile.read(sys, TRD_SECTOR_SIZE) == TRD_SECTOR_SIZE &&
+        sys[0xE7] == 0x10) {
+      diskType = sys[0xE3];
+    }
+    imageFile.close();
+  }
+  
+  setTrdGeometry(disk, diskType);
+  
+  DBG("  Format: TR-DOS (");
+  DBG(disk->tracks);
+  DBG("T/16S/256B)");
+  if (diskType == 0) {
+    DBGLN(" [no system sector, size-based]");
+  } else {
+    DBGLN();
+  }
+  return diskType != 0;
+}
+
+bool DiskManager::parseSCL(uint8_t drive, const char* filename) {
+  File32 imageFile = sd->open(filename, O_READ);
+  if (!imageFile) {
+    return false;
+  }
+  
+  uint8_t header[9];
+  if (imageFile.read(header, 9) != 9 || strncmp((char*)header, "SINCLAIR", 8) != 0) {
+    imageFile.close();
+    return false;
+  }
+  
+  uint8_t fileCount = header[8];
+  if (fileCount > TRD_MAX_FILES) {
+    imageFile.close();
+    return false;
+  }
+  
+  // Build catalog: SCL headers are the first 14 bytes of each TR-DOS entry,
+  // file data follows contiguously from track 1 sector 0
+  uint8_t* cat = trdCatalog[drive];
+  memset(cat, 0, TRD_CATALOG_SIZE);
+  
+  uint16_t nextSector = TRD_SECTORS_PER_TRACK;
+  uint8_t deleted = 0;
+  for (int i = 0; i < fileCount; i++) {
+    uint8_t* entry = cat + i * 16;
+    if (imageFile.read(entry, 14) != 14) {
+      imageFile.close();
+      return false;
+    }
+    if (entry[0] == 0x01) deleted++;
+    entry[14] = nextSector % TRD_SECTORS_PER_TRACK;
+    entry[15] = nextSector / TRD_SECTORS_PER_TRACK;
+    nextSector += entry[13];
+  }
+  
+  uint32_t dataOffset = 9 + (uint32_t)fileCount * 14;
+  uint16_t dataSectors = nextSector - TRD_SECTORS_PER_TRACK;
+  uint32_t fileSize = imageFile.size();
+  imageFile.close();
+  
+  if (nextSector > TRD_TOTAL_SECTORS ||
+      fileSize < dataOffset + (uint32_t)dataSectors * TRD_SECTOR_SIZE) {
+    return false;
+  }
+  
+  // System sector
+  uint8_t* sys = cat + 8 * TRD_SECTOR_SIZE;
+  uint16_t freeSectors = TRD_TOTAL_SECTORS - nextSector;
+  sys[0xE1] = nextSector % TRD_SECTORS_PER_TRACK;
+  sys[0xE2] = nextSector / TRD_SECTORS_PER_TRACK;
+  sys[0xE3] = 0x16;
+  sys[0xE4] = fileCount;
+  sys[0xE5] = freeSectors & 0xFF;
+  sys[0xE6] = freeSectors >> 8;
+  sys[0xE7] = 0x10;
+  memset(sys + 0xEA, ' ', 9);
+  sys[0xF4] = deleted;
+  
+  // Disk label from the image filename
+  const char* base = disks[drive].filename;
+  for (int i = 0; i < 8; i++) {
+    char c = (*base && *base != '.') ? toupper(*base++) : ' ';
+    sys[0xF5 + i] = c;
+  }
+  
+  DiskImage* disk = &disks[drive];
+  disk->isSCL = true;
+  disk->sclDataOffset = dataOffset;
+  disk->sclDataSectors = dataSectors;
+  setTrdGeometry(disk, 0x16);
+  
+  DBG("  Format: SCL (");
+  DBG(fileCount);
+  DBG(" files, ");
+  DBG(dataSectors);
+  DBGLN(" sectors) as virtual TRD 160T/16S/256B");
+  return true;
+}
+
+bool DiskManager::expandSCL(uint8_t drive) {
+  DiskImage* disk = &disks[drive];
+  
+  char sclName[70];
+  snprintf(sclName, sizeof(sclName), "/%s", disk->filename);
+  
+  // Pick an unused NAME.TRD, NAME_1.TRD, ... next to the SCL
+  char baseName[64];
+  strncpy(baseName, disk->filename, 63);
+  baseName[63] = '\0';
+  char* dot = strrchr(baseName, '.');
+  if (dot) *dot = '\0';
+  
+  // Base name capped at 56 chars so "_n.TRD" always fits in 63
+  char trdName[64];
+  char trdPath[70];
+  bool found = false;
+  for (int n = 0; n < 10 && !found; n++) {
+    int len;
+    if (n == 0) {
+      len = snprintf(trdName, sizeof(trdName), "%.56s.TRD", baseName);
+    } else {
+      len = snprintf(trdName, sizeof(trdName), "%.56s_%d.TRD", baseName, n);
+    }
+    if (len < 0 || len >= (int)sizeof(trdName)) break;
+    snprintf(trdPath, sizeof(trdPath), "/%s", trdName);
+    found = !sd->exists(trdPath);
+  }
+  if (!found) {
+    DBGLN("SCL expand: no free TRD filename");
+    return false;
+  }
+  
+  File32 src = sd->open(sclName, O_READ);
+  if (!src) {
+    return false;
+  }
+  File32 dst = sd->open(trdPath, O_WRITE | O_CREAT | O_TRUNC);
+  if (!dst) {
+    src.close();
+    return false;
+  }
+  
+  DBG("SCL expand: ");
+  DBG(disk->filename);
+  DBG(" -> ");
+  DBGLN(trdName);
+  
+  bool ok = true;
+  uint8_t buf[TRD_SECTOR_SIZE];
+  
+  // Track 0: catalog, system sector, then empty sectors
+  ok = dst.write(trdCatalog[drive], TRD_CATALOG_SIZE) == TRD_CATALOG_SIZE;
+  memset(buf, 0, sizeof(buf));
+  for (int i = TRD_CATALOG_SECTORS; ok && i < TRD_SECTORS_PER_TRACK; i++) {
+    ok = dst.write(buf, TRD_SECTOR_SIZE) == TRD_SECTOR_SIZE;
+  }
+  
+  // File data only: the image stays trimmed, free space reads as zeros
+  // and is extended on demand by storeSector()
+  ok = ok && src.seek(disk->sclDataOffset);
+  for (uint16_t i = 0; ok && i < disk->sclDataSectors; i++) {
+    ok = src.read(buf, TRD_SECTOR_SIZE) == TRD_SECTOR_SIZE &&
+         dst.write(buf, TRD_SECTOR_SIZE) == TRD_SECTOR_SIZE;
+  }
+  
+  uint32_t trdSize = dst.size();
+  src.close();
+  dst.flush();
+  dst.close();
+  
+  if (!ok) {
+    DBGLN("SCL expand: write failed");
+    sd->remove(trdPath);
+    return false;
+  }
+  
+  // Remount the drive on the expanded image
+  strncpy(disk->filename, trdName, 63);
+  disk->filename[63] = '\0';
+  disk->size = trdSize;
+  disk->isSCL = false;
+  disk->isTRD = true;
+  disk->sclDataOffset = 0;
+  disk->sclDataSectors = 0;
+  
+  // List the TRD so the saved config can find it after a reboot; with a
+  // full list it takes over the SCL's entry until the next scan
+  int index = loadedImageIndex[drive];
+  if (totalImages < MAX_DISK_IMAGES) {
+    index = totalImages++;
+  }
+  if (index >= 0) {
+    strncpy(diskImages[index], trdName, 63);
+    diskImages[index][63] = '\0';
+    loadedImageIndex[drive] = index;
+  }
+  saveConfig();
+  
+  return true;
+}
+
+uint32_t DiskManager::sectorOffset(const DiskImage* disk, uint8_t track, uint8_t sector) {
+  if (disk->isExtendedDSK) {
+    uint32_t trackSize = disk->trackHeaderSize +
+                         (disk->sectorsPerTrack * disk->sectorSize);
+    return disk->headerOffset +
+           (track * trackSize) +
+           disk->trackHeaderSize +
+           ((sector - 1) * disk->sectorSize);
+  }
+  return ((uint32_t)track * disk->sectorsPerTrack + (sector - 1)) * disk->sectorSize;
+}
+
+bool DiskManager::readSector(uint8_t drive, uint8_t track, uint8_t sector, uint8_t* buf) {
+  DiskImage* disk = getDisk(drive);
+  if (!disk || disk->size == 0) return false;
+  if (sector < 1 || sector > disk->sectorsPerTrack) return false;
+  
+  if (cacheDrive == drive && cacheTrack == track && (cacheDirty & (1UL << (sector - 1)))) {
+    memcpy(buf, &cacheData[(sector - 1) * disk->sectorSize], disk->sectorSize);
+    return true;
+  }
+  
+  uint32_t offset;
+  if (disk->isSCL) {
+    uint32_t lsn = (uint32_t)track * TRD_SECTORS_PER_TRACK + (sector - 1);
+    if (lsn < TRD_CATALOG_SECTORS) {
+      memcpy(buf, &trdCatalog[drive][lsn * TRD_SECTOR_SIZE], TRD_SECTOR_SIZE);
+      return true;
+    }
+    if (lsn < TRD_SECTORS_PER_TRACK ||
+        lsn - TRD_SECTORS_PER_TRACK >= disk->sclDataSectors) {
+      memset(buf, 0, TRD_SECTOR_SIZE);
+      return true;
+    }
+    offset = disk->sclDataOffset + (lsn - TRD_SECTORS_PER_TRACK) * TRD_SECTOR_SIZE;
+  } else {
+    offset = sectorOffset(disk, track, sector);
+  }
+  
+  char filename[70];
+  snprintf(filename, sizeof(filename), "/%s", disk->filename);
+  
+  File32 imageFile = sd->open(filename, O_READ);
+  if (!imageFile) return false;
+  
+  // Trimmed TRD images end after the last used sector
+  if (disk->isTRD && offset >= imageFile.size()) {
+    imageFile.close();
+    memset(buf, 0, disk->sectorSize);
+    return true;
+  }
+  
+  imageFile.seek(offset);
+  int bytesRead = imageFile.read(buf, disk->sectorSize);
+  imageFile.close();
+  
+  if (disk->isTRD && bytesRead >= 0 && bytesRead < disk->sectorSize) {
+    memset(buf + bytesRead, 0, disk->sectorSize - bytesRead);
+    return true;
+  }
+  return bytesRead == disk->sectorSize;
+}
+
+bool DiskManager::writeSector(uint8_t drive, uint8_t track, uint8_t sector, const uint8_t* buf) {
+  DiskImage* disk = getDisk(drive);
+  if (!disk || disk->size == 0) return false;
+  if (sector < 1 || sector > disk->sectorsPerTrack) return false;
+  
+  // A track that cannot be flushed keeps the cache; report this write failed
+  if (cacheDirty && (cacheDrive != drive || cacheTrack != track) && !flushCache()) {
+    return false;
+  }
+  
+  // Cache the sector; it reaches SD when the write command ends (flushCache)
+  if (sector <= 32 && (uint32_t)sector * disk->sectorSize <= WRITE_CACHE_SIZE) {
+    memcpy(&cacheData[(sector - 1) * disk->sectorSize], buf, disk->sectorSize);
+    cacheDrive = drive;
+    cacheTrack = track;
+    cacheDirty |= 1UL << (sector - 1);
+    return true;
+  }
+  
+  // First write to an SCL materialises it as a TRD
+  if (disk->isSCL && !expandSCL(drive)) return false;
+  
+  char filename[70];
+  snprintf(filename, sizeof(filename), "/%s", disk->filename);
+  
+  File32 imageFile = sd->open(filename, O_WRITE);
+  if (!imageFile) return false;
+  
+  bool ok = storeSector(imageFile, disk, track, sector, buf);
+  imageFile.flush();
+  delay(10);
+  imageFile.close();
+  delay(5);
+  
+  return ok;
+}
+
+bool DiskManager::storeSector(File32& imageFile, const DiskImage* disk, uint8_t track,
+                              uint8_t sector, const uint8_t* buf) {
+  uint32_t offset = sectorOffset(disk, track, sector);
+  
+  // Extend trimmed TRD images up to the target sector
+  if (disk->isTRD && offset > imageFile.size()) {
+    uint8_t zero[TRD_SECTOR_SIZE];
+    memset(zero, 0, sizeof(zero));
+    uint32_t end = imageFile.size();
+    if (!imageFile.seek(end)) return false;
+    while (end < offset) {
+      uint32_t n = min((uint32_t)sizeof(zero), offset - end);
+      if (imageFile.write(zero, n) != n) return false;
+      end += n;
+    }
+  }
+  
+  if (!imageFile.seek(offset)) return false;
+  return imageFile.write(buf, disk->sectorSize) == disk->sectorSize;
+}
+
+bool DiskManager::flushCache() {
+  if (!cacheDirty) return true;
+  
+  uint8_t drive = cacheDrive;
+  uint8_t track = cacheTrack;
+  DiskImage* disk = &disks[drive];
+  uint16_t written = 0;
+  
+  // First write to an SCL materialises it as a TRD
+  if (disk->size != 0 && (!disk->isSCL || expandSCL(drive))) {
+    char filename[70];
+    snprintf(filename, sizeof(filename), "/%s", disk->filename);
+    
+    File32 imageFile = sd->open(filename, O_WRITE);
+    if (imageFile) {
+      for (uint8_t s = 1; s <= disk->sectorsPerTrack && s <= 32; s++) {
+        if (!(cacheDirty & (1UL << (s - 1)))) continue;
+        if (storeSector(imageFile, disk, track, s, &cacheData[(s - 1) * disk->sectorSize])) {
+          cacheDirty &= ~(1UL << (s - 1));
+          written++;
+        }
+      }
+      imageFile.flush();
+      delay(10);
+      imageFile.close();
+      delay(5);
+    }
+  }
+  
+  if (cacheDirty) {
+    // Sectors that did not reach SD stay cached for the next flush
+    DBG("Warning: Flush failed for drive ");
+    DBGLN(drive);
+    return false;
+  }
+  
+  cacheDrive = -1;
+  eventBus.publish(EVT_FLUSH_DONE, drive, track, written);
+  return true;
+}
+
+void DiskManager::releaseCache() {
+  // Last chance before the drive changes image; data that still cannot be
+  // written must not land in the next image
+  if (!flushCache()) {
+    DBGLN("Warning: Discarding unwritten sectors");
+    cacheDirty = 0;
+  }
+  cacheDrive = -1;
+}
+
 void DiskManager::saveConfig() {
   // Remove existing file
   if (sd->exists(LASTIMG_FILE)) {
@@ -3,10 +3,12 @@
 #include <SdFat.h>
 #include "DiskImage.h"
 #include "Hardware.h"
+#include "EventBus.h"
 
 #define MAX_DISK_IMAGES 100
 #define MAX_DRIVES 2
 #define LASTIMG_FILE "/lastimg.cfg"
+#define WRITE_CACHE_SIZE 4608  // one track: 16x256 or 9x512
 
 class DiskManager {
 public:
@@ -32,6 +34,14 @@ public:
   DiskImage* getDisk(uint8_t drive);
   int getLoadedIndex(uint8_t drive) const;
   
+  // Sector I/O (track is the linear image track, sector is 1-based)
+  bool readSector(uint8_t drive, uint8_t track, uint8_t sector, uint8_t* buf);
+  bool writeSector(uint8_t drive, uint8_t track, uint8_t sector, const uint8_t* buf);
+  
+  // Track cache: sectors of a write command reach SD on flushCache(), which
+  // returns false (and keeps them cached) if they could not be written
+  bool flushCache();
+  
 private:
   SdFat32* sd;
   
@@ -43,7 +53,26 @@ private:
   // Loaded disk data
   DiskImage disks[MAX_DRIVES];
   
+  // Synthesised TR-DOS catalog and system sector for mounted SCL files
+  uint8_t trdCatalog[MAX_DRIVES][TRD_CATALOG_SIZE];
+  
+  // Dirty sectors of one track awaiting flush
+  uint8_t cacheData[WRITE_CACHE_SIZE];
+  int8_t cacheDrive;
+  uint8_t cacheTrack;
+  uint32_t cacheDirty;
+  
   // Format detection
   bool detectFormat(DiskImage* disk, uint32_t fileSize);
   bool parseExtendedDSK(uint8_t drive, const char* filename);
+  bool parseTRD(uint8_t drive, const char* filename);
+  bool parseSCL(uint8_t drive, const char* filename);
+  void setTrdGeometry(DiskImage* disk, uint8_t diskType);
+  bool expandSCL(uint8_t drive);
+  void releaseCache();
+  
+  // Geometry
+  uint32_t sectorOffset(const DiskImage* disk, uint8_t track, uint8_t sector);
+  bool storeSector(File32& imageFile, const DiskImage* disk, uint8_t track,
+                   uint8_t sector, const uint8_t* buf);
 };
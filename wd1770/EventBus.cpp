@@ -0,0 +1,79 @@
+#include "EventBus.h"
+
+EventBus eventBus;
+
+EventBus::EventBus() {
+  for (uint32_t i = 0; i < EVENT_QUEUE_SIZE; i++) {
+    cells[i].seq = i;
+  }
+  head = 0;
+  tail = 0;
+  dropped = 0;
+  listenerCount = 0;
+}
+
+bool EventBus::publish(uint8_t type, uint8_t drive, uint16_t arg, uint32_t value) {
+  // Each cell's seq equals the position it will next accept; producers
+  // claim a position with CAS, fill the cell, then release it to the consumer
+  EventCell* cell;
+  uint32_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  for (;;) {
+    cell = &cells[pos & (EVENT_QUEUE_SIZE - 1)];
+    uint32_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    int32_t diff = (int32_t)(seq - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&head, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    }
+  }
+
+  cell->event.type = type;
+  cell->event.drive = drive;
+  cell->event.arg = arg;
+  cell->event.value = value;
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool EventBus::pop(Event& e) {
+  EventCell* cell = &cells[tail & (EVENT_QUEUE_SIZE - 1)];
+  uint32_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+  if ((int32_t)(seq - (tail + 1)) < 0) {
+    return false;
+  }
+
+  e = cell->event;
+  __atomic_store_n(&cell->seq, tail + EVENT_QUEUE_SIZE, __ATOMIC_RELEASE);
+  tail++;
+  return true;
+}
+
+bool EventBus::subscribe(EventListener* listener, uint32_t mask) {
+  if (!listener || listenerCount >= MAX_EVENT_LISTENERS) {
+    DBGLN("EventBus: Too many listeners");
+    return false;
+  }
+  listeners[listenerCount].listener = listener;
+  listeners[listenerCount].mask = mask;
+  listenerCount++;
+  return true;
+}
+
+void EventBus::dispatch() {
+  // Bounded so listeners that publish cannot starve the loop
+  Event e;
+  for (int n = 0; n < EVENT_QUEUE_SIZE && pop(e); n++) {
+    for (uint8_t i = 0; i < listenerCount; i++) {
+      if (listeners[i].mask & EVT_MASK(e.type)) {
+        listeners[i].listener->onEvent(e);
+      }
+    }
+  }
+}
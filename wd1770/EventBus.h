@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Hardware.h"
+
+// Fixed-capacity multi-producer event queue between subsystems.
+// publish() is lock-free and safe from ISRs; dispatch() runs from loop()
+// and delivers each event to the listeners subscribed to its type.
+
+#define EVENT_QUEUE_SIZE    32          // power of two
+#define MAX_EVENT_LISTENERS 8
+
+typedef enum {
+  EVT_MOUNT_COMPLETE,   // drive, arg = image index (0xFFFF = ejected)
+  EVT_DRIVE_NOT_READY,  // drive, arg = command
+  EVT_DIRTY_TRACK,      // drive, arg = track
+  EVT_FLUSH_DONE,       // drive, arg = track, value = sectors written
+  EVT_STATS_TICK,       // drive = active, arg = track, value = sniff captured | total << 16
+  EVT_BUTTON,           // drive = button id
+  EVT_COUNT
+} EventType;
+
+#define EVT_MASK(t)     (1UL << (t))
+
+// Button ids for EVT_BUTTON
+#define BUTTON_ID_UP      0
+#define BUTTON_ID_DOWN    1
+#define BUTTON_ID_SELECT  2
+
+typedef struct {
+  uint8_t type;
+  uint8_t drive;
+  uint16_t arg;
+  uint32_t value;
+} Event;
+
+class EventListener {
+public:
+  virtual void onEvent(const Event& e) = 0;
+};
+
+class EventBus {
+public:
+  EventBus();
+
+  // Producers (any context)
+  bool publish(uint8_t type, uint8_t drive = 0, uint16_t arg = 0, uint32_t value = 0);
+
+  // Consumer (loop only)
+  bool subscribe(EventListener* listener, uint32_t mask);
+  void dispatch();
+
+  uint32_t getDropped() const { return dropped; }
+
+private:
+  typedef struct {
+    volatile uint32_t seq;
+    Event event;
+  } EventCell;
+
+  typedef struct {
+    EventListener* listener;
+    uint32_t mask;
+  } Subscription;
+
+  EventCell cells[EVENT_QUEUE_SIZE];
+  volatile uint32_t head;
+  uint32_t tail;
+  volatile uint32_t dropped;
+
+  Subscription listeners[MAX_EVENT_LISTENERS];
+  uint8_t listenerCount;
+
+  bool pop(Event& e);
+};
+
+extern EventBus eventBus;
@@ -8,6 +8,16 @@ extern int WD_A0, WD_A1, WD_CS, WD_RW;
 extern int WD_INTRQ, WD_DRQ;
 extern int WD_DDEN, WD_DS0, WD_DS1;
 
+// Sniffer fed by the CS interrupt in sniff mode
+static BusSniffer* sniffTarget = nullptr;
+
+static void onSniffChipSelect() {
+  // D0-D7 are PB0-PB7: one port read, before the host ends the cycle
+  uint8_t data = GPIOB->IDR & 0xFF;
+  uint8_t addr = (digitalRead(WD_A1) << 1) | digitalRead(WD_A0);
+  sniffTarget->captureCycle(addr, digitalRead(WD_RW) == HIGH, data);
+}
+
 FdcDevice::FdcDevice() {
   diskManager = nullptr;
   sd = nullptr;
@@ -16,6 +26,12 @@ FdcDevice::FdcDevice() {
   lastRW = true;
   dataBusDriven = false;
   dataValidUntil = 0;
+  sniffMode = false;
+  trackDirty = false;
+  lastStatsTick = 0;
+  statsDrive = 0xFF;
+  statsTrack = 0;
+  statsSniff = 0;
   
   memset(&fdc, 0, sizeof(FDCState));
 }
@@ -40,6 +56,8 @@ void FdcDevice::begin() {
   fdc.state = STATE_IDLE;
   fdc.sectorsRemaining = 0;
   fdc.multiSector = false;
+  
+  eventBus.subscribe(this, EVT_MASK(EVT_MOUNT_COMPLETE));
 }
 
 void FdcDevice::setDiskManager(DiskManager* dm) {
@@ -50,6 +68,23 @@ void FdcDevice::setSD(SdFat32* sdCard) {
   sd = sdCard;
 }
 
+bool FdcDevice::beginSniffing(uint8_t tracks, uint8_t sectorsPerTrack, uint16_t sectorSize) {
+  if (!sd) return false;
+  
+  // The real controller owns the data bus, INTRQ and DRQ
+  releaseDataBus();
+  pinMode(WD_INTRQ, INPUT);
+  pinMode(WD_DRQ, INPUT);
+  
+  sniffMode = sniffer.begin(sd, tracks, sectorsPerTrack, sectorSize);
+  if (sniffMode) {
+    // Sample every cycle on the CS edge so SD writes cannot miss one
+    sniffTarget = &sniffer;
+    attachInterrupt(digitalPinToInterrupt(WD_CS), onSniffChipSelect, FALLING);
+  }
+  return sniffMode;
+}
+
 bool FdcDevice::isEnabled() {
   return (digitalRead(WD_DDEN) == LOW);
 }
@@ -99,6 +134,11 @@ void FdcDevice::releaseDataBus() {
 }
 
 void FdcDevice::handleBus() {
+  if (sniffMode) {
+    sniffBus();
+    return;
+  }
+  
   bool cs = (digitalRead(WD_CS) == LOW);
   bool rw = (digitalRead(WD_RW) == HIGH);
   
@@ -128,6 +168,11 @@ void FdcDevice::handleBus() {
   lastRW = rw;
 }
 
+void FdcDevice::sniffBus() {
+  // Cycles are sampled by the CS interrupt; never drive the bus
+  sniffer.processCycles();
+}
+
 void FdcDevice::handleRead(uint8_t addr) {
   uint8_t value = 0;
   
@@ -213,6 +258,15 @@ void FdcDevice::handleWrite(uint8_t addr) {
   }
 }
 
+int FdcDevice::getMaxTrack() {
+  // Double-sided TR-DOS images expose up to 160 linear tracks
+  DiskImage* currentDisk = diskManager ? diskManager->getDisk(activeDrive) : nullptr;
+  if (currentDisk && currentDisk->size != 0 && currentDisk->tracks > MAX_TRACKS) {
+    return currentDisk->tracks - 1;
+  }
+  return MAX_TRACKS;
+}
+
 uint32_t FdcDevice::getStepRate() {
   uint8_t rateCode = fdc.command & 0x03;
   switch (rateCode) {
@@ -281,6 +335,7 @@ void FdcDevice::cmdReadSector() {
   if (!currentDisk || currentDisk->size == 0) {
     fdc.status = ST_RNF;
     fdc.intrq = true;
+    eventBus.publish(EVT_DRIVE_NOT_READY, activeDrive, fdc.command);
     return;
   }
   
@@ -305,6 +360,7 @@ void FdcDevice::cmdWriteSector() {
   if (!currentDisk || currentDisk->size == 0) {
     fdc.status = ST_RNF;
     fdc.intrq = true;
+    eventBus.publish(EVT_DRIVE_NOT_READY, activeDrive, fdc.command);
     return;
   }
   
@@ -342,11 +398,11 @@ void FdcDevice::cmdReadAddress() {
 }
 
 void FdcDevice::cmdForceInterrupt() {
+  fdc.status = endWrite() ? 0 : ST_WRITE_PROTECT;
   fdc.busy = false;
   fdc.drq = false;
   fdc.intrq = true;
   fdc.state = STATE_IDLE;
-  fdc.status = 0;
 }
 
 void FdcDevice::readSectorData() {
@@ -370,38 +426,8 @@ void FdcDevice::readSectorData() {
     return;
   }
   
-  // Calculate offset
-  uint32_t offset;
-  char filename[70];
-  snprintf(filename, sizeof(filename), "/%s", currentDisk->filename);
-  
-  if (currentDisk->isExtendedDSK) {
-    uint32_t trackSize = currentDisk->trackHeaderSize + 
-                         (currentDisk->sectorsPerTrack * currentDisk->sectorSize);
-    offset = currentDisk->headerOffset +
-             (fdc.currentTrack * trackSize) +
-             currentDisk->trackHeaderSize +
-             ((fdc.sector - 1) * currentDisk->sectorSize);
-  } else {
-    offset = (fdc.currentTrack * currentDisk->sectorsPerTrack + (fdc.sector - 1)) * 
-             currentDisk->sectorSize;
-  }
-  
   // Read sector
-  File32 imageFile = sd->open(filename, O_READ);
-  if (!imageFile) {
-    fdc.status = ST_RNF;
-    fdc.busy = false;
-    fdc.intrq = true;
-    fdc.state = STATE_IDLE;
-    return;
-  }
-  
-  imageFile.seek(offset);
-  size_t bytesRead = imageFile.read(fdc.sectorBuffer, currentDisk->sectorSize);
-  imageFile.close();
-  
-  if (bytesRead != currentDisk->sectorSize) {
+  if (!diskManager->readSector(activeDrive, fdc.currentTrack, fdc.sector, fdc.sectorBuffer)) {
     fdc.status = ST_RNF;
     fdc.busy = false;
     fdc.intrq = true;
@@ -428,26 +454,9 @@ void FdcDevice::writeSectorData() {
     return;
   }
   
-  // Calculate offset
-  uint32_t offset;
-  char filename[70];
-  snprintf(filename, sizeof(filename), "/%s", currentDisk->filename);
-  
-  if (currentDisk->isExtendedDSK) {
-    uint32_t trackSize = currentDisk->trackHeaderSize +
-                         (currentDisk->sectorsPerTrack * currentDisk->sectorSize);
-    offset = currentDisk->headerOffset +
-             (fdc.currentTrack * trackSize) +
-             currentDisk->trackHeaderSize +
-             ((fdc.sector - 1) * currentDisk->sectorSize);
-  } else {
-    offset = (fdc.currentTrack * currentDisk->sectorsPerTrack + (fdc.sector - 1)) *
-             currentDisk->sectorSize;
-  }
-  
-  // Write sector
-  File32 imageFile = sd->open(filename, O_WRITE);
-  if (!imageFile) {
+  // Write sector (an SCL is expanded to TRD on first write)
+  if (!diskManager->writeSector(activeDrive, fdc.currentTrack, fdc.sector, fdc.sectorBuffer)) {
+    endWrite();
     fdc.status = ST_WRITE_PROTECT;
     fdc.busy = false;
     fdc.intrq = true;
@@ -455,17 +464,61 @@ void FdcDevice::writeSectorData() {
     return;
   }
   
-  imageFile.seek(offset);
-  imageFile.write(fdc.sectorBuffer, currentDisk->sectorSize);
-  imageFile.flush();
-  delay(10);
-  imageFile.close();
-  delay(5);
-  
+  if (!trackDirty) {
+    trackDirty = true;
+    eventBus.publish(EVT_DIRTY_TRACK, activeDrive, fdc.currentTrack);
+  }
   fdc.state = STATE_SECTOR_WRITE_COMPLETE;
 }
 
+bool FdcDevice::endWrite() {
+  // The command's cached sectors reach SD before its status is reported,
+  // so a failed write is seen by the host
+  if (!trackDirty) return true;
+  trackDirty = false;
+  return diskManager->flushCache();
+}
+
+void FdcDevice::publishStats() {
+  uint32_t sniffStats = 0;
+  if (sniffMode) {
+    sniffStats = sniffer.getCapturedCount() | ((uint32_t)sniffer.getTotalSectors() << 16);
+  }
+  if (activeDrive == statsDrive && fdc.currentTrack == statsTrack && sniffStats == statsSniff) {
+    return;
+  }
+  
+  // Remembered only once queued, so a full queue is retried next tick
+  if (eventBus.publish(EVT_STATS_TICK, activeDrive, fdc.currentTrack, sniffStats)) {
+    statsDrive = activeDrive;
+    statsTrack = fdc.currentTrack;
+    statsSniff = sniffStats;
+  }
+}
+
+void FdcDevice::onEvent(const Event& e) {
+  if (e.type == EVT_MOUNT_COMPLETE && e.drive == activeDrive && fdc.busy) {
+    // Media changed under a running command
+    trackDirty = false;
+    fdc.busy = false;
+    fdc.drq = false;
+    fdc.intrq = true;
+    fdc.status = ST_NOT_READY;
+    fdc.state = STATE_IDLE;
+  }
+}
+
 void FdcDevice::processStateMachine() {
+  if (millis() - lastStatsTick >= STATS_TICK_MS) {
+    lastStatsTick = millis();
+    publishStats();
+  }
+  
+  if (sniffMode) {
+    sniffer.service();
+    return;
+  }
+  
   uint32_t now = micros();
   
   switch (fdc.state) {
@@ -493,9 +546,10 @@ void FdcDevice::processStateMachine() {
           fdc.state = STATE_IDLE;
         } else {
           // STEP, STEP_IN, STEP_OUT
-          fdc.currentTrack += fdc.direction;
-          if (fdc.currentTrack < 0) fdc.currentTrack = 0;
-          if (fdc.currentTrack > MAX_TRACKS) fdc.currentTrack = MAX_TRACKS;
+          int track = fdc.currentTrack + fdc.direction;
+          if (track < 0) track = 0;
+          if (track > getMaxTrack()) track = getMaxTrack();
+          fdc.currentTrack = track;
           
           if (fdc.command & 0x10) {
             fdc.track = fdc.currentTrack;
@@ -542,10 +596,10 @@ void FdcDevice::processStateMachine() {
         fdc.drq = true;
         fdc.state = STATE_WAITING_FOR_DATA_IN;
       } else {
+        fdc.status = endWrite() ? 0 : ST_WRITE_PROTECT;
         fdc.busy = false;
         fdc.drq = false;
         fdc.intrq = true;
-        fdc.status = 0;
         fdc.state = STATE_IDLE;
       }
       break;
@@ -553,6 +607,7 @@ void FdcDevice::processStateMachine() {
 }
 
 void FdcDevice::updateOutputs() {
+  if (sniffMode) return;
   digitalWrite(WD_INTRQ, fdc.intrq ? HIGH : LOW);
   digitalWrite(WD_DRQ, fdc.drq ? HIGH : LOW);
 }
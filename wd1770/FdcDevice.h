@@ -4,6 +4,8 @@
 #include <SdFat.h>
 #include "DiskImage.h"
 #include "DiskManager.h"
+#include "BusSniffer.h"
+#include "EventBus.h"
 
 // Command types
 #define CMD_RESTORE         0x00
@@ -50,6 +52,7 @@
 #define HEAD_SETTLE_TIME    15000
 #define SECTOR_READ_TIME    3000
 #define SECTOR_WRITE_TIME   3000
+#define STATS_TICK_MS       250     // minimum gap between STATS_TICK events
 
 // FDC State machine
 enum FDCStateEnum {
@@ -89,7 +92,7 @@ typedef struct {
   bool multiSector;
 } FDCState;
 
-class FdcDevice {
+class FdcDevice : public EventListener {
 public:
   FdcDevice();
   
@@ -115,6 +118,14 @@ public:
   // Output signals
   void updateOutputs();
   
+  // Listen-only mode: image a real disk from host <-> WD1770 traffic
+  bool beginSniffing(uint8_t tracks, uint8_t sectorsPerTrack, uint16_t sectorSize);
+  bool isSniffing() const { return sniffMode; }
+  BusSniffer* getSniffer() { return &sniffer; }
+  
+  // Events
+  void onEvent(const Event& e) override;
+  
   // State access
   bool isBusy() const { return fdc.busy; }
   uint8_t getCurrentTrack() const { return fdc.currentTrack; }
@@ -126,6 +137,17 @@ private:
   SdFat32* sd;
   uint8_t activeDrive;
   
+  // Bus sniffing
+  BusSniffer sniffer;
+  bool sniffMode;
+  
+  // Event state
+  bool trackDirty;
+  uint32_t lastStatsTick;
+  uint8_t statsDrive;
+  uint8_t statsTrack;
+  uint32_t statsSniff;
+  
   // Bus state tracking
   bool lastCS;
   bool lastRW;
@@ -140,6 +162,7 @@ private:
   void driveDataBus(uint8_t data);
   void releaseDataBus();
   uint8_t readDataBus();
+  void sniffBus();
   
   // Command handlers
   void cmdRestore();
@@ -158,4 +181,11 @@ private:
   
   // Timing
   uint32_t getStepRate();
+  
+  // Geometry
+  int getMaxTrack();
+  
+  // Events
+  bool endWrite();
+  void publishStats();
 };
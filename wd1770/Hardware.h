@@ -11,6 +11,9 @@
   #define DBGLN(...)
 #endif
 
+// Set to 1 to enable the PC-sampling profiler (see Profiler.h)
+#define PROFILER_ENABLED 0
+
 // SD Card SPI pins
 #define SD_CS_PIN       PA4
 
@@ -2,6 +2,8 @@
 
 #define BUTTON_DEBOUNCE_MS 50
 #define DISPLAY_UPDATE_INTERVAL 100
+#define NOT_READY_SHOW_MS 2000
+#define WRITE_SHOW_MS 500
 
 #define OLED_FONT u8g2_font_6x10_tr
 
@@ -10,7 +12,18 @@ extern int TEST_MODE;
 
 OledUI::OledUI() : u8g2(U8G2_R0, OLED_SCL, OLED_SDA, U8X8_PIN_NONE) {
   diskManager = nullptr;
-  fdcDevice = nullptr;
+  activeDrive = 0;
+  currentTrack = 0;
+  sniffCaptured = 0;
+  sniffTotal = 0;
+  for (int i = 0; i < MAX_DRIVES; i++) {
+    writePending[i] = false;
+    writeShowing[i] = false;
+    writeTime[i] = 0;
+  }
+  notReadyDrive = -1;
+  notReadyTime = 0;
+  needsRedraw = true;
   uiMode = UI_MODE_NORMAL;
   tempDrive0Index = 0;
   tempDrive1Index = -1;
@@ -32,6 +45,9 @@ bool OledUI::begin() {
   u8g2.drawStr(0, 22, "Initializing...");
   u8g2.sendBuffer();
   
+  eventBus.subscribe(this, EVT_MASK(EVT_MOUNT_COMPLETE) | EVT_MASK(EVT_DRIVE_NOT_READY) |
+                           EVT_MASK(EVT_DIRTY_TRACK) | EVT_MASK(EVT_FLUSH_DONE) |
+                           EVT_MASK(EVT_STATS_TICK) | EVT_MASK(EVT_BUTTON));
   return true;
 }
 
@@ -39,8 +55,54 @@ void OledUI::setDiskManager(DiskManager* dm) {
   diskManager = dm;
 }
 
-void OledUI::setFdcDevice(FdcDevice* fdc) {
-  fdcDevice = fdc;
+void OledUI::onEvent(const Event& e) {
+  switch (e.type) {
+    case EVT_MOUNT_COMPLETE:
+      if (e.drive < MAX_DRIVES) {
+        writePending[e.drive] = false;
+        writeShowing[e.drive] = false;
+      }
+      needsRedraw = true;
+      break;
+      
+    case EVT_DRIVE_NOT_READY:
+      notReadyDrive = e.drive;
+      notReadyTime = millis();
+      needsRedraw = true;
+      break;
+      
+    case EVT_DIRTY_TRACK:
+      if (e.drive < MAX_DRIVES) {
+        writePending[e.drive] = true;
+        writeShowing[e.drive] = true;
+        writeTime[e.drive] = millis();
+      }
+      needsRedraw = true;
+      break;
+      
+    case EVT_FLUSH_DONE:
+      // Usually arrives in the same dispatch as DIRTY_TRACK; the W stays
+      // up for WRITE_SHOW_MS (periodicUpdate) so a write is always visible
+      if (e.drive < MAX_DRIVES) writePending[e.drive] = false;
+      break;
+      
+    case EVT_STATS_TICK:
+      if (e.drive != activeDrive || e.arg != currentTrack ||
+          (e.value & 0xFFFF) != sniffCaptured || (e.value >> 16) != sniffTotal) {
+        activeDrive = e.drive;
+        currentTrack = e.arg;
+        sniffCaptured = e.value & 0xFFFF;
+        sniffTotal = e.value >> 16;
+        needsRedraw = true;
+      }
+      break;
+      
+    case EVT_BUTTON:
+      if (e.drive == BUTTON_ID_UP) handleUpButton();
+      else if (e.drive == BUTTON_ID_DOWN) handleDownButton();
+      else if (e.drive == BUTTON_ID_SELECT) handleSelectButton();
+      break;
+  }
 }
 
 void OledUI::checkInput() {
@@ -61,7 +123,7 @@ void OledUI::checkInput() {
     if (now - lastUpPress > BUTTON_DEBOUNCE_MS) {
       lastUpPress = now;
       lastActivityTime = now;
-      handleUpButton();
+      eventBus.publish(EVT_BUTTON, BUTTON_ID_UP);
     }
   }
   
@@ -70,7 +132,7 @@ void OledUI::checkInput() {
     if (now - lastDownPress > BUTTON_DEBOUNCE_MS) {
       lastDownPress = now;
       lastActivityTime = now;
-      handleDownButton();
+      eventBus.publish(EVT_BUTTON, BUTTON_ID_DOWN);
     }
   }
   
@@ -87,7 +149,7 @@ void OledUI::checkInput() {
     
     if (pressDuration >= BUTTON_DEBOUNCE_MS) {
       lastActivityTime = now;
-      handleSelectButton();
+      eventBus.publish(EVT_BUTTON, BUTTON_ID_SELECT);
     }
     
     selectPressed = false;
@@ -291,14 +353,25 @@ void OledUI::periodicUpdate() {
     u8g2.sendBuffer();
     return;
   }
-  if (uiMode == UI_MODE_NORMAL && now - lastDisplayUpdate > DISPLAY_UPDATE_INTERVAL) {
+  if (notReadyDrive >= 0 && now - notReadyTime > NOT_READY_SHOW_MS) {
+    notReadyDrive = -1;
+    needsRedraw = true;
+  }
+  for (int i = 0; i < MAX_DRIVES; i++) {
+    if (writeShowing[i] && !writePending[i] && now - writeTime[i] > WRITE_SHOW_MS) {
+      writeShowing[i] = false;
+      needsRedraw = true;
+    }
+  }
+  if (uiMode == UI_MODE_NORMAL && needsRedraw && now - lastDisplayUpdate > DISPLAY_UPDATE_INTERVAL) {
     displayNormalMode();
     lastDisplayUpdate = now;
   }
 }
 
 void OledUI::displayNormalMode() {
-  if (!diskManager || !fdcDevice) return;
+  if (!diskManager) return;
+  needsRedraw = false;
   
   char buf[32];
   u8g2.clearBuffer();
@@ -315,8 +388,8 @@ void OledUI::displayNormalMode() {
     sprintf(buf, "A:%s", fname);
     u8g2.drawStr(0, 10, buf);
     
-    if (fdcDevice->getActiveDrive() == 0) {
-      sprintf(buf, " T:%d/%d", fdcDevice->getCurrentTrack(), diskA->tracks - 1);
+    if (activeDrive == 0) {
+      sprintf(buf, " T:%d/%d%s", currentTrack, diskA->tracks - 1, writeShowing[0] ? " W" : "");
     } else {
       strcpy(buf, " T:--");
     }
@@ -337,8 +410,8 @@ void OledUI::displayNormalMode() {
     sprintf(buf, "B:%s", fname);
     u8g2.drawStr(0, 34, buf);
     
-    if (fdcDevice->getActiveDrive() == 1) {
-      sprintf(buf, " T:%d/%d", fdcDevice->getCurrentTrack(), diskB->tracks - 1);
+    if (activeDrive == 1) {
+      sprintf(buf, " T:%d/%d%s", currentTrack, diskB->tracks - 1, writeShowing[1] ? " W" : "");
     } else {
       strcpy(buf, " T:--");
     }
@@ -349,7 +422,13 @@ void OledUI::displayNormalMode() {
   }
   
   // Status line
-  if (TEST_MODE) {
+  if (notReadyDrive >= 0) {
+    sprintf(buf, "%c: NOT READY", 'A' + notReadyDrive);
+    u8g2.drawStr(0, 64, buf);
+  } else if (sniffTotal > 0) {
+    sprintf(buf, "SNIFF %d/%d", sniffCaptured, sniffTotal);
+    u8g2.drawStr(0, 64, buf);
+  } else if (TEST_MODE) {
     u8g2.drawStr(0, 64, "TEST MODE");
     u8g2.drawStr(60, 64, "Select=Menu");
   } else {
@@ -4,7 +4,7 @@
 #include "DiskImage.h"
 #include "DiskManager.h"
 #include "Hardware.h"
-#include "FdcDevice.h"
+#include "EventBus.h"
 
 // UI Mode enumeration
 typedef enum {
@@ -17,7 +17,7 @@ typedef enum {
 
 // OLED pins - declared in Hardware.h
 
-class OledUI {
+class OledUI : public EventListener {
 public:
   OledUI();
   
@@ -33,13 +33,26 @@ public:
   
   // Link to other subsystems
   void setDiskManager(DiskManager* dm);
-  void setFdcDevice(FdcDevice* fdc);
+  
+  // Events
+  void onEvent(const Event& e) override;
   
 private:
   U8G2_SH1106_128X64_NONAME_F_SW_I2C u8g2;
   
   DiskManager* diskManager;
-  FdcDevice* fdcDevice;
+  
+  // State reported by events
+  uint8_t activeDrive;
+  uint8_t currentTrack;
+  uint16_t sniffCaptured;
+  uint16_t sniffTotal;
+  bool writePending[MAX_DRIVES];
+  bool writeShowing[MAX_DRIVES];
+  unsigned long writeTime[MAX_DRIVES];
+  int8_t notReadyDrive;
+  unsigned long notReadyTime;
+  bool needsRedraw;
   
   // UI state
   UIMode uiMode;
@@ -0,0 +1,142 @@
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+
+static volatile uint32_t histogram[PROF_BUCKETS];
+static volatile uint32_t totalSamples = 0;
+static volatile uint32_t outsideSamples = 0;
+static volatile uint32_t isrSamples = 0;
+
+static uint32_t ramVectors[PROF_VECTORS] __attribute__((aligned(512)));
+
+extern "C" __attribute__((used)) void profRecordSample(uint32_t* frame, uint32_t excReturn) {
+  PROF_TIMER->SR = ~TIM_SR_UIF;
+
+  // Exception frame: r0 r1 r2 r3 r12 lr pc xpsr
+  uint32_t bucket = (frame[6] - PROF_FLASH_BASE) >> PROF_BUCKET_SHIFT;
+  totalSamples++;
+  if (!(excReturn & 0x08)) {
+    // Returning to handler mode: the sample interrupted another ISR
+    isrSamples++;
+  }
+  if (bucket < PROF_BUCKETS) {
+    histogram[bucket]++;
+  } else {
+    outsideSamples++;
+  }
+}
+
+extern "C" __attribute__((naked)) void profSampleHandler(void) {
+  __asm volatile(
+    "tst lr, #4            \n"
+    "ite eq                \n"
+    "mrseq r0, msp         \n"
+    "mrsne r0, psp         \n"
+    "mov r1, lr            \n"
+    "b profRecordSample    \n");
+}
+
+Profiler::Profiler() {
+  running = false;
+}
+
+void Profiler::begin() {
+  // Same vectors as the core, except TIM11 goes to the sampling handler
+  memcpy(ramVectors, (const void*)SCB->VTOR, sizeof(ramVectors));
+  ramVectors[16 + PROF_TIMER_IRQ] = (uint32_t)profSampleHandler;
+  __disable_irq();
+  SCB->VTOR = (uint32_t)ramVectors;
+  __DSB();
+  __enable_irq();
+
+  // 1MHz timer tick; APB2 timers run at twice PCLK2 when it is divided
+  __HAL_RCC_TIM11_CLK_ENABLE();
+  uint32_t clock = HAL_RCC_GetPCLK2Freq();
+  if (RCC->CFGR & RCC_CFGR_PPRE2) clock *= 2;
+  PROF_TIMER->CR1 = 0;
+  PROF_TIMER->PSC = clock / 1000000 - 1;
+  PROF_TIMER->ARR = 1000000 / PROF_SAMPLE_HZ - 1;
+  PROF_TIMER->EGR = TIM_EGR_UG;
+  PROF_TIMER->SR = 0;
+  PROF_TIMER->DIER = TIM_DIER_UIE;
+
+  NVIC_SetPriority(PROF_TIMER_IRQ, 0);
+  NVIC_EnableIRQ(PROF_TIMER_IRQ);
+  reset();
+}
+
+void Profiler::start() {
+  if (running) return;
+  PROF_TIMER->CR1 |= TIM_CR1_CEN;
+  running = true;
+}
+
+void Profiler::stop() {
+  if (!running) return;
+  PROF_TIMER->CR1 &= ~TIM_CR1_CEN;
+  running = false;
+}
+
+void Profiler::reset() {
+  bool wasRunning = running;
+  stop();
+  for (int i = 0; i < PROF_BUCKETS; i++) histogram[i] = 0;
+  totalSamples = 0;
+  outsideSamples = 0;
+  isrSamples = 0;
+  if (wasRunning) start();
+}
+
+void Profiler::dump(Print& out) {
+  bool wasRunning = running;
+  stop();
+
+  out.println("PROF BEGIN");
+  out.print("base ");
+  out.println(PROF_FLASH_BASE, HEX);
+  out.print("shift ");
+  out.println(PROF_BUCKET_SHIFT);
+  out.print("hz ");
+  out.println(PROF_SAMPLE_HZ);
+  out.print("samples ");
+  out.println(totalSamples);
+  out.print("outside ");
+  out.println(outsideSamples);
+  out.print("isr ");
+  out.println(isrSamples);
+
+  for (int i = 0; i < PROF_BUCKETS; i++) {
+    if (histogram[i] == 0) continue;
+    out.print("b ");
+    out.print(i, HEX);
+    out.print(" ");
+    out.println(histogram[i]);
+  }
+  out.println("PROF END");
+
+  if (wasRunning) start();
+}
+
+void Profiler::handleSerial() {
+  while (Serial.available()) {
+    switch (Serial.read()) {
+      case 's':
+        start();
+        Serial.println("PROF started");
+        break;
+      case 'x':
+        stop();
+        Serial.println("PROF stopped");
+        break;
+      case 'r':
+        reset();
+        Serial.println("PROF reset");
+        break;
+      case 'p':
+        dump(Serial);
+        break;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Hardware.h"
+
+// Statistical PC-sampling profiler.
+// TIM11 interrupts at PROF_SAMPLE_HZ at the highest priority; its naked
+// handler reads the interrupted PC from its own exception frame and bumps a
+// flash-address bucket, so time inside other interrupt handlers (USB CDC,
+// SysTick, the sniff-mode CS interrupt) is charged to the handler itself.
+// Buckets are dumped over Serial and symbolised on the host with
+// tools/profsym.py against the sketch ELF.
+//
+// The core already owns the TIM11 vector, so begin() moves the vector table
+// to RAM and installs the sampling handler there.
+
+#define PROF_FLASH_BASE     0x08000000UL
+#define PROF_BUCKET_SHIFT   6           // 64-byte buckets
+#define PROF_BUCKETS        4096        // 256KB of flash
+#define PROF_SAMPLE_HZ      997         // prime, avoids locking to periodic work
+#define PROF_TIMER          TIM11
+#define PROF_TIMER_IRQ      TIM1_TRG_COM_TIM11_IRQn
+#define PROF_VECTORS        128         // 16 system + up to 112 IRQ entries
+
+class Profiler {
+public:
+  Profiler();
+
+  // Initialization
+  void begin();
+
+  // Sampling control
+  void start();
+  void stop();
+  void reset();
+  bool isRunning() const { return running; }
+
+  // Report
+  void dump(Print& out);
+
+  // Serial commands: s=start x=stop r=reset p=dump
+  void handleSerial();
+
+private:
+  bool running;
+};
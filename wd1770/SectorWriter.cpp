@@ -0,0 +1,198 @@
+#include "SectorWriter.h"
+
+SectorWriter::SectorWriter() {
+  sd = nullptr;
+  imageFile[0] = '\0';
+  coverageFile[0] = '\0';
+  tracks = 0;
+  sectorsPerTrack = 0;
+  sectorSize = 0;
+  slotsPerBuffer = 0;
+  active = 0;
+  writtenCount = 0;
+  unsavedCount = 0;
+  overruns = 0;
+  memset(buffers, 0, sizeof(buffers));
+  memset(coverage, 0, sizeof(coverage));
+}
+
+bool SectorWriter::begin(SdFat32* sdCard, const char* imagePath, const char* coveragePath,
+                         uint8_t numTracks, uint8_t spt, uint16_t size) {
+  sd = sdCard;
+  if (!sd || numTracks == 0 || numTracks > SNIFF_MAX_TRACKS ||
+      spt == 0 || spt > SNIFF_MAX_SLOTS || size == 0 || size > SNIFF_BUF_SIZE) {
+    DBGLN("SectorWriter: Invalid geometry");
+    return false;
+  }
+
+  strncpy(imageFile, imagePath, sizeof(imageFile) - 1);
+  imageFile[sizeof(imageFile) - 1] = '\0';
+  strncpy(coverageFile, coveragePath, sizeof(coverageFile) - 1);
+  coverageFile[sizeof(coverageFile) - 1] = '\0';
+  tracks = numTracks;
+  sectorsPerTrack = spt;
+  sectorSize = size;
+  slotsPerBuffer = min(SNIFF_BUF_SIZE / size, SNIFF_MAX_SLOTS);
+
+  memset(buffers, 0, sizeof(buffers));
+  active = 0;
+  overruns = 0;
+
+  bool resumed = prepareImage();
+  memset(coverage, 0, sizeof(coverage));
+  writtenCount = 0;
+  unsavedCount = 0;
+  if (resumed) {
+    loadCoverage();
+  } else if (sd->exists(coverageFile)) {
+    sd->remove(coverageFile);
+  }
+  return sd->exists(imageFile);
+}
+
+bool SectorWriter::prepareImage() {
+  uint32_t imageSize = (uint32_t)tracks * sectorsPerTrack * sectorSize;
+  bool existed = sd->exists(imageFile);
+
+  File32 image = sd->open(imageFile, O_WRITE | O_CREAT);
+  if (!image) {
+    DBGLN("SectorWriter: Could not create image");
+    return false;
+  }
+
+  uint32_t current = image.size();
+  if (current < imageSize) {
+    // Zero-fill so sectors can be written in any order
+    image.seek(current);
+    while (current < imageSize) {
+      uint32_t n = min((uint32_t)sectorSize, imageSize - current);
+      image.write(buffers[0].data, n);
+      current += n;
+    }
+    image.flush();
+    existed = false;
+  }
+  image.close();
+  return existed;
+}
+
+void SectorWriter::loadCoverage() {
+  File32 file = sd->open(coverageFile, O_READ);
+  if (!file) return;
+
+  uint8_t header[4];
+  if (file.read(header, 4) == 4 &&
+      header[0] == tracks && header[1] == sectorsPerTrack &&
+      (header[2] | (header[3] << 8)) == sectorSize) {
+    file.read(coverage, sizeof(coverage));
+  }
+  file.close();
+
+  for (uint16_t i = 0; i < getTotalSectors(); i++) {
+    if (coverage[i >> 3] & (1 << (i & 7))) writtenCount++;
+  }
+  DBG("SectorWriter: Resuming, ");
+  DBG(writtenCount);
+  DBGLN(" sectors already captured");
+}
+
+void SectorWriter::saveCoverage() {
+  File32 file = sd->open(coverageFile, O_WRITE | O_CREAT | O_TRUNC);
+  if (!file) return;
+
+  uint8_t header[4] = { tracks, sectorsPerTrack,
+                        (uint8_t)(sectorSize & 0xFF), (uint8_t)(sectorSize >> 8) };
+  file.write(header, 4);
+  file.write(coverage, sizeof(coverage));
+  file.close();
+  unsavedCount = 0;
+}
+
+bool SectorWriter::syncCoverage() {
+  if (!unsavedCount) return false;
+  saveCoverage();
+  return true;
+}
+
+uint8_t* SectorWriter::reserve() {
+  SniffBuffer* buf = &buffers[active];
+  if (buf->count >= slotsPerBuffer) {
+    buf->ready = true;
+  }
+  if (buf->ready) {
+    // Non-active buffer is always either empty or awaiting flush
+    SniffBuffer* other = &buffers[active ^ 1];
+    if (other->ready) {
+      overruns++;
+      return nullptr;
+    }
+    active ^= 1;
+    buf = other;
+  }
+  return &buf->data[buf->count * sectorSize];
+}
+
+void SectorWriter::commit(uint8_t track, uint8_t sector) {
+  SniffBuffer* buf = &buffers[active];
+  if (buf->ready || buf->count >= slotsPerBuffer) return;
+  if (track >= tracks || sector < 1 || sector > sectorsPerTrack) return;
+
+  buf->track[buf->count] = track;
+  buf->sector[buf->count] = sector;
+  buf->count++;
+}
+
+void SectorWriter::seal() {
+  SniffBuffer* buf = &buffers[active];
+  if (buf->count == 0 || buf->ready) return;
+  buf->ready = true;
+  if (!buffers[active ^ 1].ready) {
+    active ^= 1;
+  }
+}
+
+uint16_t SectorWriter::flush() {
+  if (!hasReady()) return 0;
+
+  // Older buffer first so rewrites of the same sector keep the latest data
+  uint16_t written = 0;
+  if (buffers[active ^ 1].ready) written += flushBuffer(&buffers[active ^ 1]);
+  if (buffers[active].ready) written += flushBuffer(&buffers[active]);
+
+  if (unsavedCount >= SNIFF_COVERAGE_BATCH) saveCoverage();
+  return written;
+}
+
+uint16_t SectorWriter::flushBuffer(SniffBuffer* buf) {
+  uint16_t written = 0;
+
+  File32 image = sd->open(imageFile, O_WRITE);
+  if (image) {
+    for (uint8_t i = 0; i < buf->count; i++) {
+      uint16_t index = (uint16_t)buf->track[i] * sectorsPerTrack + (buf->sector[i] - 1);
+      image.seek((uint32_t)index * sectorSize);
+      if (image.write(&buf->data[i * sectorSize], sectorSize) != sectorSize) break;
+
+      if (!(coverage[index >> 3] & (1 << (index & 7)))) {
+        coverage[index >> 3] |= (1 << (index & 7));
+        writtenCount++;
+        unsavedCount++;
+      }
+      written++;
+    }
+    image.flush();
+    image.close();
+  } else {
+    DBGLN("SectorWriter: Could not open image");
+  }
+
+  buf->count = 0;
+  buf->ready = false;
+  return written;
+}
+
+bool SectorWriter::isWritten(uint8_t track, uint8_t sector) const {
+  if (track >= tracks || sector < 1 || sector > sectorsPerTrack) return false;
+  uint16_t index = (uint16_t)track * sectorsPerTrack + (sector - 1);
+  return coverage[index >> 3] & (1 << (index & 7));
+}
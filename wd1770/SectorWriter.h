@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SdFat.h>
+#include "Hardware.h"
+
+// Double-buffered sector writer for bus sniffing.
+// Captured sectors go straight into a slot of the active buffer; sealed
+// buffers are written to the image while capture continues in the other
+// buffer. The coverage map is saved in batches, after the image data, so
+// it never claims a sector that is not on SD.
+
+#define SNIFF_BUF_SIZE      4608        // one track: 16x256 or 9x512
+#define SNIFF_MAX_SLOTS     18
+#define SNIFF_MAX_TRACKS    84
+#define SNIFF_COVERAGE_SIZE ((SNIFF_MAX_TRACKS * SNIFF_MAX_SLOTS + 7) / 8)
+#define SNIFF_COVERAGE_BATCH 128        // new sectors between coverage saves
+
+typedef struct {
+  uint8_t data[SNIFF_BUF_SIZE];
+  uint8_t track[SNIFF_MAX_SLOTS];
+  uint8_t sector[SNIFF_MAX_SLOTS];
+  uint8_t count;
+  bool ready;
+} SniffBuffer;
+
+class SectorWriter {
+public:
+  SectorWriter();
+
+  // Initialization (creates or resumes the image and its coverage map)
+  bool begin(SdFat32* sdCard, const char* imagePath, const char* coveragePath,
+             uint8_t tracks, uint8_t sectorsPerTrack, uint16_t sectorSize);
+
+  // Capture side
+  uint8_t* reserve();
+  void commit(uint8_t track, uint8_t sector);
+  void seal();
+
+  // Storage side
+  bool hasReady() const { return buffers[0].ready || buffers[1].ready; }
+  uint16_t flush();
+  bool syncCoverage();
+
+  // Coverage
+  bool isWritten(uint8_t track, uint8_t sector) const;
+  uint16_t getWrittenCount() const { return writtenCount; }
+  uint16_t getTotalSectors() const { return (uint16_t)tracks * sectorsPerTrack; }
+  uint16_t getOverruns() const { return overruns; }
+  uint8_t getTracks() const { return tracks; }
+  uint8_t getSectorsPerTrack() const { return sectorsPerTrack; }
+  uint16_t getSectorSize() const { return sectorSize; }
+
+private:
+  SdFat32* sd;
+  char imageFile[24];
+  char coverageFile[24];
+  uint8_t tracks;
+  uint8_t sectorsPerTrack;
+  uint16_t sectorSize;
+  uint8_t slotsPerBuffer;
+
+  SniffBuffer buffers[2];
+  uint8_t active;
+
+  uint8_t coverage[SNIFF_COVERAGE_SIZE];
+  uint16_t writtenCount;
+  uint16_t unsavedCount;
+  uint16_t overruns;
+
+  bool prepareImage();
+  void loadCoverage();
+  void saveCoverage();
+  uint16_t flushBuffer(SniffBuffer* buf);
+};
@@ -14,10 +14,17 @@
    - DiskManager: Disk file operations and format detection
    - FdcDevice: WD1770 emulation logic
    - OledUI: User interface and display
+   - EventBus: Lock-free event queue between the subsystems above
+   - Profiler: PC-sampling profiler (PROFILER_ENABLED in Hardware.h)
    
    TEST MODE:
    - Set TEST_MODE=1 to simulate FDC signals without connecting to real hardware
    - Set TEST_MODE=0 when connecting to actual Timex or other system
+   
+   SNIFF MODE:
+   - Set SNIFF_MODE=1 to run alongside a real WD1770 without driving the bus
+   - Sectors the host reads or writes are captured to /SNIFF.IMG
+   - With TEST_MODE=1 the recorded trace /SNIFF.TRC is replayed at boot
 */
 
 #include <Arduino.h>
@@ -26,27 +33,35 @@
 
 // Include all modules
 #include "Hardware.h"
+#include "EventBus.h"
 #include "DiskImage.h"
 #include "DiskManager.h"
 #include "FdcDevice.h"
 #include "OledUI.h"
+#include "Profiler.h"
 
 // ===================== CONFIGURATION =====================
 
 // Test mode - simulates Timex system signals
 int TEST_MODE = 1;  // Set to 0 when connecting to real hardware
 
+// Sniff mode - passive imaging of a disk in a real WD1770 system
+int SNIFF_MODE = 0;
+
 // ===================== GLOBAL OBJECTS =====================
 
 SdFat32 SD;
 DiskManager diskManager;
 FdcDevice fdcDevice;
 OledUI ui;
+#if PROFILER_ENABLED
+Profiler profiler;
+#endif
 
 // ===================== INITIALIZATION =====================
 
 void setup() {
-  #if DEBUG_SERIAL
+#if DEBUG_SERIAL || PROFILER_ENABLED
   Serial.begin(115200);
 #endif
   delay(2000);
@@ -93,13 +108,23 @@ void setup() {
   fdcDevice.setDiskManager(&diskManager);
   fdcDevice.setSD(&SD);
   
-  // Link UI to subsystems
+  if (SNIFF_MODE) {
+    if (fdcDevice.beginSniffing(SNIFF_TRACKS, SNIFF_SECTORS, SNIFF_SECTOR_SIZE) && TEST_MODE) {
+      fdcDevice.getSniffer()->replay(SNIFF_TRACE_FILE);
+    }
+  }
+  
+  // Link UI to disk manager (FDC state arrives via events)
   ui.setDiskManager(&diskManager);
-  ui.setFdcDevice(&fdcDevice);
   
   // Initial display update
   ui.updateDisplay();
   
+#if PROFILER_ENABLED
+  profiler.begin();
+  profiler.start();
+#endif
+
   DBGLN("Ready!");
   DBGLN("Safe to reset/power off anytime EXCEPT during 'Saving config...' message");
 }
@@ -128,8 +153,15 @@ void loop() {
     fdcDevice.disable();
   }
   
+  // Deliver queued events to subscribers
+  eventBus.dispatch();
+  
   // Periodic display update (100ms interval)
   ui.periodicUpdate();
+
+#if PROFILER_ENABLED
+  profiler.handleSerial();
+#endif
 }
 
 // ===================== PIN INITIALIZATION =====================
@@ -152,11 +184,16 @@ void initPins() {
   pinMode(WD_CS, INPUT);
   pinMode(WD_RW, INPUT);
   
-  // Output signals
-  pinMode(WD_INTRQ, OUTPUT);
-  pinMode(WD_DRQ, OUTPUT);
-  digitalWrite(WD_INTRQ, LOW);
-  digitalWrite(WD_DRQ, LOW);
+  // Output signals (driven by the real controller in sniff mode)
+  if (SNIFF_MODE) {
+    pinMode(WD_INTRQ, INPUT);
+    pinMode(WD_DRQ, INPUT);
+  } else {
+    pinMode(WD_INTRQ, OUTPUT);
+    pinMode(WD_DRQ, OUTPUT);
+    digitalWrite(WD_INTRQ, LOW);
+    digitalWrite(WD_DRQ, LOW);
+  }
   
   // Input signals (with pull-downs for test mode)
   if (TEST_MODE) {